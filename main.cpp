@@ -77,17 +77,19 @@ namespace shapes
             using namespace svg;
             using namespace std::literals;
 
-            const auto base_circle = Circle().SetFillColor("rgb(240,240,240)"s).SetStrokeColor("black");
-            container.Add( //
-                Circle(base_circle)
-                    .SetCenter({head_center_.x, head_center_.y + 5 * head_radius_})
-                    .SetRadius(2 * head_radius_));
-
-            container.Add( //
-                Circle(base_circle)
-                    .SetCenter({head_center_.x, head_center_.y + 2 * head_radius_})
-                    .SetRadius(1.5 * head_radius_));
-            container.Add(Circle(base_circle).SetCenter(head_center_).SetRadius(head_radius_));
+            // Общий стиль всех снеговиков: круги ссылаются на него, не копируя строки
+            static const auto base_style = std::make_shared<const PathStyle>(
+                PathStyle{"rgb(240,240,240)"s, "black"s, std::nullopt, std::nullopt, std::nullopt});
+            container.Emplace<Circle>()
+                .SetBaseStyle(base_style)
+                .SetCenter({head_center_.x, head_center_.y + 5 * head_radius_})
+                .SetRadius(2 * head_radius_);
+
+            container.Emplace<Circle>()
+                .SetBaseStyle(base_style)
+                .SetCenter({head_center_.x, head_center_.y + 2 * head_radius_})
+                .SetRadius(1.5 * head_radius_);
+            container.Emplace<Circle>().SetBaseStyle(base_style).SetCenter(head_center_).SetRadius(head_radius_);
         }
 
     private:
@@ -145,19 +147,24 @@ int main()
     // svg::Document doc;
     // DrawPicture(picture, doc);
 
-    // const Text base_text = //
-    //     Text()
-    //         .SetFontFamily("Verdana"s)
-    //         .SetFontSize(12)
-    //         .SetPosition({10, 100})
-    //         .SetData("Happy New Year!"s);
-    // doc.Add(Text{base_text}
-    //             .SetStrokeColor("yellow"s)
-    //             .SetFillColor("yellow"s)
-    //             .SetStrokeLineJoin(StrokeLineJoin::ROUND)
-    //             .SetStrokeLineCap(StrokeLineCap::ROUND)
-    //             .SetStrokeWidth(3));
-    // doc.Add(Text{base_text}.SetFillColor("red"s));
+    // // Общий шрифт подписей: тексты ссылаются на него, не копируя строки
+    // static const auto base_font = std::make_shared<const FontStyle>(FontStyle{"Verdana"s, ""s});
+    // doc.Emplace<Text>()
+    //     .SetBaseFontStyle(base_font)
+    //     .SetFontSize(12)
+    //     .SetPosition({10, 100})
+    //     .SetData("Happy New Year!"s)
+    //     .SetStrokeColor("yellow"s)
+    //     .SetFillColor("yellow"s)
+    //     .SetStrokeLineJoin(StrokeLineJoin::ROUND)
+    //     .SetStrokeLineCap(StrokeLineCap::ROUND)
+    //     .SetStrokeWidth(3);
+    // doc.Emplace<Text>()
+    //     .SetBaseFontStyle(base_font)
+    //     .SetFontSize(12)
+    //     .SetPosition({10, 100})
+    //     .SetData("Happy New Year!"s)
+    //     .SetFillColor("red"s);
 
     // doc.Render(cout);
 
@@ -173,11 +180,11 @@ int main()
         const double t = double(i) / (num_circles - 1);
 
         const Rgb fill_color = Lerp(start_color, end_color, t);
-        doc.Add(Circle()
-                    .SetFillColor(fill_color)
-                    .SetStrokeColor("black"s)
-                    .SetCenter({i * 20.0 + 40, 40.0})
-                    .SetRadius(15));
+        doc.Emplace<Circle>()
+            .SetFillColor(fill_color)
+            .SetStrokeColor("black"s)
+            .SetCenter({i * 20.0 + 40, 40.0})
+            .SetRadius(15);
     }
     doc.Render(cout);
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "svg.h"
 
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
 namespace svg
 {
 
@@ -77,6 +81,100 @@ namespace svg
         return out;
     }
 
+    namespace
+    {
+        bool IsHexDigit(char c)
+        {
+            return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+        }
+
+        bool IsLetter(char c)
+        {
+            return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+        }
+
+        bool IsNumberChar(char c)
+        {
+            return (c >= '0' && c <= '9') || c == '.' || c == '%';
+        }
+
+        // Проверяет аргументы записи rgb(...): ровно три числа без прозрачности.
+        // Записи rgb(r,g,b,alpha) и rgb(r g b / alpha) считаются прозрачными
+        bool IsOpaqueRgb(std::string_view args)
+        {
+            if (args.empty() || args.back() != ')')
+            {
+                return false;
+            }
+            args.remove_suffix(1);
+            std::size_t components = 0;
+            std::size_t pos = 0;
+            while (pos < args.size())
+            {
+                const char c = args[pos];
+                if (c == ',' || c == ' ')
+                {
+                    ++pos;
+                    continue;
+                }
+                if (!IsNumberChar(c))
+                {
+                    return false;
+                }
+                while (pos < args.size() && IsNumberChar(args[pos]))
+                {
+                    ++pos;
+                }
+                ++components;
+            }
+            return components == 3;
+        }
+
+        // Непрозрачными считаются именованные цвета, #rgb, #rrggbb и rgb(...)
+        bool IsOpaque(const std::string &color)
+        {
+            if (color.size() > 1 && color[0] == '#')
+            {
+                const std::string_view digits = std::string_view(color).substr(1);
+                return (digits.size() == 3 || digits.size() == 6) &&
+                       std::all_of(digits.begin(), digits.end(), IsHexDigit);
+            }
+            if (color.rfind("rgb("sv, 0) == 0)
+            {
+                return IsOpaqueRgb(std::string_view(color).substr(4));
+            }
+            if (color.empty() || !std::all_of(color.begin(), color.end(), IsLetter))
+            {
+                return false;
+            }
+            std::string lower;
+            for (char c : color)
+            {
+                lower.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+            }
+            return lower != "none"sv && lower != "transparent"sv && lower != "currentcolor"sv &&
+                   lower != "inherit"sv;
+        }
+
+        bool IsFinite(Point p)
+        {
+            return std::isfinite(p.x) && std::isfinite(p.y);
+        }
+    } // namespace
+
+    bool IsOpaque(const Color &color)
+    {
+        if (const auto *str = std::get_if<std::string>(&color))
+        {
+            return IsOpaque(*str);
+        }
+        if (const auto *rgba = std::get_if<Rgba>(&color))
+        {
+            return rgba->opacity >= 1.0;
+        }
+        return std::holds_alternative<Rgb>(color);
+    }
+
     void Object::Render(const RenderContext &context) const
     {
         context.RenderIndent();
@@ -101,6 +199,25 @@ namespace svg
         return *this;
     }
 
+    std::optional<BoundingBox> Circle::GetBounds() const
+    {
+        const double extent = radius_ + GetStrokeExtent(false);
+        if (!IsFinite(center_) || !std::isfinite(extent) || radius_ < 0)
+        {
+            return std::nullopt;
+        }
+        return BoundingBox{{center_.x - extent, center_.y - extent}, {center_.x + extent, center_.y + extent}};
+    }
+
+    std::optional<Disk> Circle::GetOpaqueDisk() const
+    {
+        if (!HasOpaqueFill() || !IsFinite(center_) || !std::isfinite(radius_) || radius_ <= 0)
+        {
+            return std::nullopt;
+        }
+        return Disk{center_, radius_};
+    }
+
     void Circle::RenderObject(const RenderContext &context) const
     {
         auto &out = context.out;
@@ -118,6 +235,32 @@ namespace svg
         return *this;
     }
 
+    std::optional<BoundingBox> Polyline::GetBounds() const
+    {
+        if (points_.empty())
+        {
+            return std::nullopt;
+        }
+        BoundingBox box{points_.front(), points_.front()};
+        for (const Point &p : points_)
+        {
+            if (!IsFinite(p))
+            {
+                return std::nullopt;
+            }
+            box.min = {std::min(box.min.x, p.x), std::min(box.min.y, p.y)};
+            box.max = {std::max(box.max.x, p.x), std::max(box.max.y, p.y)};
+        }
+        const double extent = GetStrokeExtent(true);
+        if (!std::isfinite(extent))
+        {
+            return std::nullopt;
+        }
+        box.min = {box.min.x - extent, box.min.y - extent};
+        box.max = {box.max.x + extent, box.max.y + extent};
+        return box;
+    }
+
     void Polyline::RenderObject(const RenderContext &context) const
     {
         auto &out = context.out;
@@ -162,13 +305,13 @@ namespace svg
 
     Text &Text::SetFontFamily(std::string font_family)
     {
-        font_family_ = std::move(font_family);
+        font_.font_family = std::move(font_family);
         return *this;
     }
 
     Text &Text::SetFontWeight(std::string font_weight)
     {
-        font_weight_ = std::move(font_weight);
+        font_.font_weight = std::move(font_weight);
         return *this;
     }
 
@@ -178,6 +321,43 @@ namespace svg
         return *this;
     }
 
+    Text &Text::SetBaseFontStyle(std::shared_ptr<const FontStyle> style)
+    {
+        base_font_ = std::move(style);
+        return *this;
+    }
+
+    Point Text::GetOffset() const
+    {
+        return offset_;
+    }
+
+    const std::string &Text::GetFontFamily() const
+    {
+        return font_.font_family.empty() && base_font_ ? base_font_->font_family : font_.font_family;
+    }
+
+    const std::string &Text::GetFontWeight() const
+    {
+        return font_.font_weight.empty() && base_font_ ? base_font_->font_weight : font_.font_weight;
+    }
+
+    const std::string &Text::GetData() const
+    {
+        return data_;
+    }
+
+    BoundingBox Text::GetExtent(double width_em) const
+    {
+        // Текст выводится от опорной точки вправо, а базовая линия делит
+        // высоту шрифта примерно в отношении 4:1
+        const double size = font_size_;
+        const double stroke = GetStrokeExtent(false);
+        const Point origin{position_.x + offset_.x, position_.y + offset_.y};
+        return {{origin.x - stroke, origin.y - 0.8 * size - stroke},
+                {origin.x + width_em * size + stroke, origin.y + 0.2 * size + stroke}};
+    }
+
     void Text::RenderObject(const RenderContext &context) const
     {
         auto &out = context.out;
@@ -189,13 +369,15 @@ namespace svg
         RenderAttr(out, " dx"sv, offset_.x);
         RenderAttr(out, " dy"sv, offset_.y);
         RenderAttr(out, " font-size"sv, font_size_);
-        if (!font_family_.empty())
+        const std::string &font_family = GetFontFamily();
+        if (!font_family.empty())
         {
-            RenderAttr(out, " font-family"sv, font_family_);
+            RenderAttr(out, " font-family"sv, font_family);
         }
-        if (!font_weight_.empty())
+        const std::string &font_weight = GetFontWeight();
+        if (!font_weight.empty())
         {
-            RenderAttr(out, " font-weight"sv, font_weight_);
+            RenderAttr(out, " font-weight"sv, font_weight);
         }
         out.put('>');
         detail::HtmlEncodeString(out, data_);
@@ -211,19 +393,111 @@ namespace svg
 
     void Document::Render(std::ostream &out) const
     {
-        out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
-        out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
+        detail::RenderDocumentHeader(out);
         RenderContext ctx{out, 2, 2};
         for (const auto &obj : objects_)
         {
             obj->Render(ctx);
         }
-        out << "</svg>"sv;
+        detail::RenderDocumentFooter(out);
+    }
+
+    const std::vector<std::unique_ptr<Object>> &Document::GetObjects() const
+    {
+        return objects_;
+    }
+
+    void Document::RemoveObjects(const std::vector<bool> &remove)
+    {
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < objects_.size(); ++i)
+        {
+            if (i >= remove.size() || !remove[i])
+            {
+                objects_[kept++] = std::move(objects_[i]);
+            }
+        }
+        objects_.resize(kept);
+    }
+
+    void Document::Render(OutputSink &sink) const
+    {
+        std::ostream out{&sink};
+        // Ошибка приёмника не должна молча обрывать документ
+        out.exceptions(std::ios_base::badbit);
+        Render(out);
+        sink.Flush();
+    }
+
+    // LazyDocument
+
+    namespace
+    {
+        // Временный контейнер для объектов одного Drawable
+        class ScratchContainer final : public ObjectContainer
+        {
+        public:
+            void AddPtr(std::unique_ptr<Object> &&obj) override
+            {
+                objects_.push_back(std::move(obj));
+            }
+
+            // Выводит накопленные объекты и удаляет их, сохраняя выделенную память
+            void RenderAndClear(const RenderContext &context)
+            {
+                for (const auto &obj : objects_)
+                {
+                    obj->Render(context);
+                }
+                objects_.clear();
+            }
+
+        private:
+            std::vector<std::unique_ptr<Object>> objects_;
+        };
+    } // namespace
+
+    void LazyDocument::AddDrawable(std::unique_ptr<Drawable> &&drawable)
+    {
+        drawables_.push_back(std::move(drawable));
+    }
+
+    void LazyDocument::Render(std::ostream &out) const
+    {
+        detail::RenderDocumentHeader(out);
+        RenderContext ctx{out, 2, 2};
+        ScratchContainer scratch;
+        for (const auto &drawable : drawables_)
+        {
+            drawable->Draw(scratch);
+            scratch.RenderAndClear(ctx);
+        }
+        detail::RenderDocumentFooter(out);
+    }
+
+    void LazyDocument::Render(OutputSink &sink) const
+    {
+        std::ostream out{&sink};
+        // Ошибка приёмника не должна молча обрывать документ
+        out.exceptions(std::ios_base::badbit);
+        Render(out);
+        sink.Flush();
     }
 
     namespace detail
     {
 
+        void RenderDocumentHeader(std::ostream &out)
+        {
+            out << "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>"sv << std::endl;
+            out << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">"sv << std::endl;
+        }
+
+        void RenderDocumentFooter(std::ostream &out)
+        {
+            out << DOCUMENT_FOOTER;
+        }
+
         void HtmlEncodeString(std::ostream &out, std::string_view sv)
         {
             for (char c : sv)
@@ -23,6 +23,13 @@ namespace svg
 
         void HtmlEncodeString(std::ostream &out, std::string_view sv);
 
+        // Закрывающий тэг svg-документа
+        inline constexpr std::string_view DOCUMENT_FOOTER = "</svg>";
+
+        // Выводят пролог и закрывающий тэг svg-документа
+        void RenderDocumentHeader(std::ostream &out);
+        void RenderDocumentFooter(std::ostream &out);
+
         template <>
         inline void RenderValue<std::string>(std::ostream &out, const std::string &s)
         {
@@ -61,6 +68,20 @@ namespace svg
         double y = 0;
     };
 
+    // Прямоугольник со сторонами, параллельными осям координат
+    struct BoundingBox
+    {
+        Point min;
+        Point max;
+    };
+
+    // Круг с центром center и радиусом radius
+    struct Disk
+    {
+        Point center;
+        double radius = 0;
+    };
+
     struct Rgb
     {
         Rgb() = default;
@@ -85,6 +106,9 @@ namespace svg
     std::ostream &operator<<(std::ostream &, const Color &color);
     std::string_view operator*(const Color &color);
 
+    // Проверяет, что заливка этим цветом полностью закрывает то, что под ней
+    bool IsOpaque(const Color &color);
+
     struct ColorViewer
     {
         std::string operator()(std::monostate)
@@ -168,6 +192,19 @@ namespace svg
     public:
         void Render(const RenderContext &context) const;
 
+        // Возвращает прямоугольник, за пределами которого объект ничего не рисует,
+        // или пустое значение, если границы объекта неизвестны
+        virtual std::optional<BoundingBox> GetBounds() const
+        {
+            return std::nullopt;
+        }
+
+        // Возвращает круг, который объект гарантированно закрашивает непрозрачно
+        virtual std::optional<Disk> GetOpaqueDisk() const
+        {
+            return std::nullopt;
+        }
+
         virtual ~Object() = default;
 
     private:
@@ -194,48 +231,99 @@ namespace svg
 
     std::ostream &operator<<(std::ostream &out, StrokeLineJoin value);
 
+    /*
+     * Свойства контура, общие для всех фигур.
+     * Может использоваться как разделяемый базовый стиль, см. PathProps::SetBaseStyle
+     */
+    struct PathStyle
+    {
+        std::optional<Color> fill_color;
+        std::optional<Color> stroke_color;
+        std::optional<double> stroke_width;
+        std::optional<StrokeLineCap> stroke_line_cap;
+        std::optional<StrokeLineJoin> stroke_line_join;
+    };
+
     template <typename Owner>
     class PathProps
     {
     public:
         Owner &SetFillColor(Color color)
         {
-            fill_color_ = std::move(color);
+            style_.fill_color = std::move(color);
             return AsOwner();
         }
         Owner &SetStrokeColor(Color color)
         {
-            stroke_color_ = std::move(color);
+            style_.stroke_color = std::move(color);
             return AsOwner();
         }
         Owner &SetStrokeWidth(double width)
         {
-            stroke_width_ = width;
+            style_.stroke_width = width;
             return AsOwner();
         }
         Owner &SetStrokeLineCap(StrokeLineCap line_cap)
         {
-            stroke_line_cap_ = line_cap;
+            style_.stroke_line_cap = line_cap;
             return AsOwner();
         }
         Owner &SetStrokeLineJoin(StrokeLineJoin line_join)
         {
-            stroke_line_join_ = line_join;
+            style_.stroke_line_join = line_join;
+            return AsOwner();
+        }
+
+        // Задаёт разделяемый стиль, свойства которого используются, если не заданы
+        // собственные. Копии объекта разделяют его без копирования строк
+        Owner &SetBaseStyle(std::shared_ptr<const PathStyle> style)
+        {
+            base_style_ = std::move(style);
             return AsOwner();
         }
 
     protected:
         ~PathProps() = default;
 
+        // Насколько обводка выступает за контур фигуры с учётом соединений и концов линий
+        double GetStrokeExtent(bool has_corners) const
+        {
+            const std::optional<Color> &stroke_color = Get(&PathStyle::stroke_color);
+            if (!stroke_color || std::holds_alternative<std::monostate>(*stroke_color))
+            {
+                return 0;
+            }
+            if (const auto *name = std::get_if<std::string>(&*stroke_color); name && *name == "none")
+            {
+                return 0;
+            }
+            const double half_width = Get(&PathStyle::stroke_width).value_or(1.0) / 2;
+            if (!has_corners)
+            {
+                return half_width;
+            }
+            // Острые соединения ограничены stroke-miterlimit, по умолчанию равным 4.
+            // Квадратные концы линий выступают не более чем на половину ширины, умноженную на корень из 2
+            const StrokeLineJoin join = Get(&PathStyle::stroke_line_join).value_or(StrokeLineJoin::MITER);
+            const bool sharp = join == StrokeLineJoin::MITER || join == StrokeLineJoin::MITER_CLIP || join == StrokeLineJoin::ARCS;
+            return half_width * (sharp ? 4.0 : 1.5);
+        }
+
+        bool HasOpaqueFill() const
+        {
+            const std::optional<Color> &fill_color = Get(&PathStyle::fill_color);
+            return fill_color && IsOpaque(*fill_color);
+        }
+
         void RenderAttrs(std::ostream &out) const
         {
             using detail::RenderOptionalAttr;
             using namespace std::literals;
-            RenderOptionalAttr(out, "fill"sv, fill_color_);
-            RenderOptionalAttr(out, " stroke"sv, stroke_color_);
-            RenderOptionalAttr(out, " stroke-width"sv, stroke_width_);
-            RenderOptionalAttr(out, " stroke-linecap"sv, stroke_line_cap_);
-            RenderOptionalAttr(out, " stroke-linejoin"sv, stroke_line_join_);
+            RenderOptionalAttr(out, "fill"sv, Get(&PathStyle::fill_color));
+            RenderOptionalAttr(out, " stroke"sv, Get(&PathStyle::stroke_color));
+            RenderOptionalAttr(out, " stroke-width"sv, Get(&PathStyle::stroke_width));
+            RenderOptionalAttr(out, " stroke-linecap"sv, Get(&PathStyle::stroke_line_cap));
+            RenderOptionalAttr(out, " stroke-linejoin"sv, Get(&PathStyle::stroke_line_join));
         }
 
     private:
@@ -246,11 +334,16 @@ namespace svg
             return static_cast<Owner &>(*this);
         }
 
-        std::optional<Color> fill_color_;
-        std::optional<Color> stroke_color_;
-        std::optional<double> stroke_width_;
-        std::optional<StrokeLineCap> stroke_line_cap_;
-        std::optional<StrokeLineJoin> stroke_line_join_;
+        // Возвращает собственное свойство, а если оно не задано - свойство базового стиля
+        template <typename T>
+        const std::optional<T> &Get(std::optional<T> PathStyle::*field) const
+        {
+            const std::optional<T> &own = style_.*field;
+            return own || !base_style_ ? own : (*base_style_).*field;
+        }
+
+        PathStyle style_;
+        std::shared_ptr<const PathStyle> base_style_;
     };
 
     /*
@@ -265,6 +358,9 @@ namespace svg
         Circle &SetCenter(Point center);
         Circle &SetRadius(double radius);
 
+        std::optional<BoundingBox> GetBounds() const override;
+        std::optional<Disk> GetOpaqueDisk() const override;
+
     private:
         void RenderObject(const RenderContext &context) const override;
 
@@ -282,11 +378,20 @@ namespace svg
         // Добавляет очередную вершину к ломаной линии
         Polyline &AddPoint(Point point);
 
+        std::optional<BoundingBox> GetBounds() const override;
+
     private:
         void RenderObject(const RenderContext &context) const override;
         std::vector<Point> points_;
     };
 
+    // Свойства шрифта текста
+    struct FontStyle
+    {
+        std::string font_family;
+        std::string font_weight;
+    };
+
     /*
      * Класс Text моделирует элемент <text> для отображения текста
      * https://developer.mozilla.org/en-US/docs/Web/SVG/Element/text
@@ -312,13 +417,26 @@ namespace svg
         // Задаёт текстовое содержимое объекта (отображается внутри тэга text)
         Text &SetData(std::string data);
 
+        // Задаёт разделяемые свойства шрифта, которые используются, если не заданы собственные
+        Text &SetBaseFontStyle(std::shared_ptr<const FontStyle> style);
+
+        Point GetOffset() const;
+        const std::string &GetFontFamily() const;
+        const std::string &GetData() const;
+
+        // Возвращает прямоугольник, занимаемый текстом, если ширина строки
+        // равна width_em размеров шрифта. Учитывает смещение и обводку
+        BoundingBox GetExtent(double width_em) const;
+
     private:
         void RenderObject(const RenderContext &context) const override;
+        const std::string &GetFontWeight() const;
+
         Point position_;
         Point offset_;
         uint32_t font_size_ = 1;
-        std::string font_family_;
-        std::string font_weight_;
+        FontStyle font_;
+        std::shared_ptr<const FontStyle> base_font_;
         std::string data_;
     };
 
@@ -334,6 +452,17 @@ namespace svg
             AddPtr(std::make_unique<ObjectType>(std::move(object)));
         }
 
+        // Создаёт объект прямо в контейнере, без промежуточной копии.
+        // Возвращает ссылку на созданный объект для дальнейшей настройки
+        template <typename ObjectType, typename... Args>
+        ObjectType &Emplace(Args &&...args)
+        {
+            auto object = std::make_unique<ObjectType>(std::forward<Args>(args)...);
+            ObjectType &ref = *object;
+            AddPtr(std::move(object));
+            return ref;
+        }
+
         // Добавляет в svg-документ объект-наследник svg::Object
         virtual void AddPtr(std::unique_ptr<Object> &&obj) = 0;
 
@@ -357,6 +486,24 @@ namespace svg
         virtual ~Drawable() = default;
     };
 
+    /*
+     * Приёмник вывода svg-документа.
+     * Наследники предоставляют память для записи через интерфейс std::streambuf
+     */
+    class OutputSink : public std::streambuf
+    {
+    public:
+        // Записывает байты, которые остаются доступными до вызова Flush.
+        // Приёмник может сослаться на них без копирования
+        virtual void WriteRef(std::string_view bytes)
+        {
+            sputn(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        }
+
+        // Передаёт накопленный вывод в место назначения
+        virtual void Flush() = 0;
+    };
+
     class Document : public ObjectContainer
     {
     public:
@@ -366,8 +513,39 @@ namespace svg
         // Выводит в ostream svg-представление документа
         void Render(std::ostream &out) const;
 
+        // Выводит svg-представление документа в приёмник и сбрасывает его
+        void Render(OutputSink &sink) const;
+
+        // Возвращает объекты документа в порядке вывода
+        const std::vector<std::unique_ptr<Object>> &GetObjects() const;
+
+        // Удаляет объекты, для которых remove[i] равно true, сохраняя порядок остальных
+        void RemoveObjects(const std::vector<bool> &remove);
+
     private:
         std::vector<std::unique_ptr<Object>> objects_;
     };
 
+    /*
+     * Документ, который хранит не объекты, а рисующие их Drawable.
+     * Объекты создаются при выводе во временном контейнере и удаляются сразу
+     * после вывода, поэтому в памяти одновременно находятся только объекты
+     * одного Drawable
+     */
+    class LazyDocument
+    {
+    public:
+        // Добавляет в svg-документ рисуемый при выводе объект
+        void AddDrawable(std::unique_ptr<Drawable> &&drawable);
+
+        // Выводит в ostream svg-представление документа
+        void Render(std::ostream &out) const;
+
+        // Выводит svg-представление документа в приёмник и сбрасывает его
+        void Render(OutputSink &sink) const;
+
+    private:
+        std::vector<std::unique_ptr<Drawable>> drawables_;
+    };
+
 } // namespace svg
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include "svg_batch.h"
+
+#include <algorithm>
+#include <climits>
+#include <utility>
+
+namespace svg
+{
+
+    namespace
+    {
+        // Сколько буферов пул хранит между наборами
+        constexpr std::size_t MAX_POOLED_BUFFERS = 1024;
+
+        // Сколько кусков в среднем приходится на один поток
+        constexpr std::size_t CHUNKS_PER_WORKER = 4;
+
+        // Начальный размер строки, в которую выводится документ
+        constexpr std::size_t MIN_STRING_SIZE = 256;
+    } // namespace
+
+    // BatchRenderer::StringStreamBuf
+
+    void BatchRenderer::StringStreamBuf::Attach(std::string &str)
+    {
+        // Вывод пишется поверх старого содержимого во всю ёмкость строки
+        str_ = &str;
+        str.resize(std::max(str.capacity(), MIN_STRING_SIZE));
+        setp(str.data(), str.data() + str.size());
+    }
+
+    void BatchRenderer::StringStreamBuf::Detach()
+    {
+        str_->resize(static_cast<std::size_t>(pptr() - pbase()));
+        setp(nullptr, nullptr);
+        str_ = nullptr;
+    }
+
+    BatchRenderer::StringStreamBuf::int_type BatchRenderer::StringStreamBuf::overflow(int_type ch)
+    {
+        if (traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            return traits_type::not_eof(ch);
+        }
+        std::size_t used = static_cast<std::size_t>(pptr() - pbase());
+        str_->resize(str_->size() * 2);
+        setp(str_->data(), str_->data() + str_->size());
+        // pbump принимает int, поэтому большие смещения сдвигаются по частям
+        for (; used > INT_MAX; used -= INT_MAX)
+        {
+            pbump(INT_MAX);
+        }
+        pbump(static_cast<int>(used));
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+        return ch;
+    }
+
+    // BatchRenderer::BufferPool
+
+    void BatchRenderer::BufferPool::Acquire(std::vector<std::string> &to)
+    {
+        std::lock_guard lock(mutex);
+        for (std::string &buffer : to)
+        {
+            if (buffers.empty())
+            {
+                break;
+            }
+            buffer = std::move(buffers.back());
+            buffers.pop_back();
+        }
+    }
+
+    void BatchRenderer::BufferPool::Release(std::vector<std::string> &from)
+    {
+        std::lock_guard lock(mutex);
+        for (std::string &buffer : from)
+        {
+            if (buffers.size() >= MAX_POOLED_BUFFERS)
+            {
+                break;
+            }
+            buffers.push_back(std::move(buffer));
+        }
+        from.clear();
+    }
+
+    // BatchRenderer::Result
+
+    BatchRenderer::Result::Result(std::shared_ptr<BufferPool> pool, std::size_t size)
+        : pool_(std::move(pool)), buffers_(size)
+    {
+        pool_->Acquire(buffers_);
+    }
+
+    BatchRenderer::Result::~Result()
+    {
+        // У перемещённого результата пула нет
+        if (pool_)
+        {
+            pool_->Release(buffers_);
+        }
+    }
+
+    // BatchRenderer
+
+    BatchRenderer::BatchRenderer(std::size_t num_threads)
+    {
+        if (num_threads == 0)
+        {
+            num_threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+        }
+        for (std::size_t i = 0; i < num_threads; ++i)
+        {
+            workers_.push_back(std::make_unique<Worker>());
+            // Ошибки вывода не должны молча обрезать документ
+            workers_.back()->out.exceptions(std::ios_base::badbit);
+        }
+        for (std::size_t i = 0; i < num_threads; ++i)
+        {
+            workers_[i]->thread = std::thread([this, i]
+                                              { WorkerLoop(i); });
+        }
+    }
+
+    BatchRenderer::~BatchRenderer()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        for (auto &worker : workers_)
+        {
+            worker->thread.join();
+        }
+    }
+
+    void BatchRenderer::Render(const std::vector<const Document *> &docs, const Callback &callback)
+    {
+        Run(docs.size(), [&docs, &callback](Worker &worker, std::size_t index)
+            {
+                RenderToString(*docs[index], worker, worker.buffer);
+                callback(index, worker.buffer); });
+    }
+
+    BatchRenderer::Result BatchRenderer::Render(const std::vector<const Document *> &docs)
+    {
+        Result result{pool_, docs.size()};
+        Run(docs.size(), [&docs, &result](Worker &worker, std::size_t index)
+            { RenderToString(*docs[index], worker, result.buffers_[index]); });
+        return result;
+    }
+
+    void BatchRenderer::Run(std::size_t count, const std::function<void(Worker &, std::size_t)> &job)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+        std::lock_guard batch_lock(batch_mutex_);
+
+        std::unique_lock lock(mutex_);
+        // Потоки, проснувшиеся после конца предыдущего набора, должны увидеть пустые очереди
+        done_.wait(lock, [this]
+                   { return active_ == 0; });
+
+        const std::size_t num_chunks = std::min(count, workers_.size() * CHUNKS_PER_WORKER);
+        const std::size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+        std::size_t worker = 0;
+        for (std::size_t begin = 0; begin < count; begin += chunk_size)
+        {
+            Worker &w = *workers_[worker];
+            std::lock_guard chunk_lock(w.mutex);
+            w.chunks.push_back({begin, std::min(count, begin + chunk_size)});
+            worker = (worker + 1) % workers_.size();
+        }
+        remaining_ = count;
+        failed_ = false;
+        job_ = &job;
+        ++generation_;
+        wake_.notify_all();
+
+        done_.wait(lock, [this]
+                   { return remaining_ == 0 && active_ == 0; });
+        job_ = nullptr;
+        if (error_)
+        {
+            std::rethrow_exception(std::exchange(error_, nullptr));
+        }
+    }
+
+    void BatchRenderer::WorkerLoop(std::size_t self)
+    {
+        std::size_t seen = 0;
+        while (true)
+        {
+            const std::function<void(Worker &, std::size_t)> *job = nullptr;
+            {
+                std::unique_lock lock(mutex_);
+                wake_.wait(lock, [this, seen]
+                           { return stop_ || generation_ != seen; });
+                if (stop_)
+                {
+                    return;
+                }
+                seen = generation_;
+                if (job_ == nullptr)
+                {
+                    continue;
+                }
+                job = job_;
+                ++active_;
+            }
+
+            Worker &worker = *workers_[self];
+            Chunk chunk;
+            while (PopChunk(self, chunk))
+            {
+                RunChunk(worker, *job, chunk);
+            }
+
+            {
+                std::lock_guard lock(mutex_);
+                --active_;
+            }
+            done_.notify_all();
+        }
+    }
+
+    void BatchRenderer::RunChunk(Worker &worker, const std::function<void(Worker &, std::size_t)> &job, Chunk chunk)
+    {
+        try
+        {
+            // После ошибки оставшиеся документы набора пропускаются
+            for (std::size_t i = chunk.begin; i < chunk.end && !failed_; ++i)
+            {
+                job(worker, i);
+            }
+        }
+        catch (...)
+        {
+            std::lock_guard lock(mutex_);
+            if (!error_)
+            {
+                error_ = std::current_exception();
+            }
+            failed_ = true;
+        }
+        // Кусок учитывается всегда, иначе Run не дождётся конца набора
+        remaining_ -= chunk.end - chunk.begin;
+    }
+
+    void BatchRenderer::RenderToString(const Document &doc, Worker &worker, std::string &str)
+    {
+        worker.out.clear();
+        worker.streambuf.Attach(str);
+        try
+        {
+            doc.Render(worker.out);
+        }
+        catch (...)
+        {
+            worker.streambuf.Detach();
+            throw;
+        }
+        worker.streambuf.Detach();
+    }
+
+    bool BatchRenderer::PopChunk(std::size_t self, Chunk &chunk)
+    {
+        // Свои куски берутся с начала очереди, чужие - с конца
+        {
+            Worker &worker = *workers_[self];
+            std::lock_guard lock(worker.mutex);
+            if (!worker.chunks.empty())
+            {
+                chunk = worker.chunks.front();
+                worker.chunks.pop_front();
+                return true;
+            }
+        }
+        for (std::size_t i = 1; i < workers_.size(); ++i)
+        {
+            Worker &victim = *workers_[(self + i) % workers_.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.chunks.empty())
+            {
+                chunk = victim.chunks.back();
+                victim.chunks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+} // namespace svg
@@ -0,0 +1,185 @@
+#pragma once
+
+#include "svg.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace svg
+{
+
+    /*
+     * Выводит наборы независимых документов на фиксированном пуле потоков.
+     * Каждый поток берёт задания из своей очереди, а опустев, забирает их
+     * из очередей других потоков. Буферы вывода переиспользуются между заданиями
+     */
+    class BatchRenderer
+    {
+        struct BufferPool;
+
+    public:
+        // Вызывается из рабочего потока для каждого документа.
+        // svg действителен только до возврата из функции.
+        // Исключение из callback прерывает набор и передаётся в вызвавший Render поток
+        using Callback = std::function<void(std::size_t index, std::string_view svg)>;
+
+        /*
+         * Результат вывода набора документов.
+         * Хранит буферы пула и возвращает их в пул при уничтожении.
+         * Пул живёт, пока жив хотя бы один результат, поэтому результат
+         * может пережить BatchRenderer
+         */
+        class Result
+        {
+        public:
+            Result(Result &&) = default;
+            Result &operator=(Result &&) = delete;
+            ~Result();
+
+            std::size_t Size() const
+            {
+                return buffers_.size();
+            }
+
+            std::string_view operator[](std::size_t index) const
+            {
+                return buffers_[index];
+            }
+
+        private:
+            friend class BatchRenderer;
+
+            Result(std::shared_ptr<BufferPool> pool, std::size_t size);
+
+            std::shared_ptr<BufferPool> pool_;
+            std::vector<std::string> buffers_;
+        };
+
+        // По умолчанию создаёт по потоку на каждое ядро
+        explicit BatchRenderer(std::size_t num_threads = 0);
+        ~BatchRenderer();
+
+        BatchRenderer(const BatchRenderer &) = delete;
+        BatchRenderer &operator=(const BatchRenderer &) = delete;
+
+        // Выводит документы и передаёт результаты в callback.
+        // Возвращает управление, когда все документы выведены.
+        // Первое исключение, возникшее в рабочих потоках, выбрасывается отсюда
+        void Render(const std::vector<const Document *> &docs, const Callback &callback);
+
+        // Выводит документы в буферы пула
+        Result Render(const std::vector<const Document *> &docs);
+
+        template <typename DocumentIterator>
+        void Render(DocumentIterator begin, DocumentIterator end, const Callback &callback)
+        {
+            Render(CollectDocuments(begin, end), callback);
+        }
+
+        template <typename DocumentIterator>
+        Result Render(DocumentIterator begin, DocumentIterator end)
+        {
+            return Render(CollectDocuments(begin, end));
+        }
+
+    private:
+        // Непрерывный диапазон индексов документов [begin, end)
+        struct Chunk
+        {
+            std::size_t begin = 0;
+            std::size_t end = 0;
+        };
+
+        /*
+         * Буфер потока, пишущий прямо в память строки.
+         * Строка растёт вдвое при заполнении и обрезается до размера вывода в Detach
+         */
+        class StringStreamBuf final : public std::streambuf
+        {
+        public:
+            void Attach(std::string &str);
+            void Detach();
+
+        protected:
+            int_type overflow(int_type ch) override;
+
+        private:
+            std::string *str_ = nullptr;
+        };
+
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<Chunk> chunks;
+            std::string buffer;
+            // Поток вывода создаётся один раз и переключается между строками
+            StringStreamBuf streambuf;
+            std::ostream out{&streambuf};
+            std::thread thread;
+        };
+
+        // Буферы, переиспользуемые между наборами
+        struct BufferPool
+        {
+            void Acquire(std::vector<std::string> &buffers);
+            void Release(std::vector<std::string> &buffers);
+
+            std::mutex mutex;
+            std::vector<std::string> buffers;
+        };
+
+        template <typename DocumentIterator>
+        static std::vector<const Document *> CollectDocuments(DocumentIterator begin, DocumentIterator end)
+        {
+            std::vector<const Document *> docs;
+            for (auto it = begin; it != end; ++it)
+            {
+                const Document &doc = *it;
+                docs.push_back(&doc);
+            }
+            return docs;
+        }
+
+        // Выполняет job для каждого индекса из [0, count) на пуле потоков
+        void Run(std::size_t count, const std::function<void(Worker &, std::size_t)> &job);
+        void WorkerLoop(std::size_t self);
+        bool PopChunk(std::size_t self, Chunk &chunk);
+        void RunChunk(Worker &worker, const std::function<void(Worker &, std::size_t)> &job, Chunk chunk);
+
+        static void RenderToString(const Document &doc, Worker &worker, std::string &str);
+
+        std::vector<std::unique_ptr<Worker>> workers_;
+
+        // Текущее задание. Защищено mutex_
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable done_;
+        const std::function<void(Worker &, std::size_t)> *job_ = nullptr;
+        std::size_t generation_ = 0;
+        // Число потоков, которые сейчас разбирают очереди
+        std::size_t active_ = 0;
+        bool stop_ = false;
+        std::atomic<std::size_t> remaining_{0};
+        // Первое исключение текущего набора. Защищено mutex_
+        std::exception_ptr error_;
+        std::atomic<bool> failed_{false};
+
+        // Наборы выводятся по одному
+        std::mutex batch_mutex_;
+
+        std::shared_ptr<BufferPool> pool_ = std::make_shared<BufferPool>();
+    };
+
+} // namespace svg
@@ -0,0 +1,453 @@
+#include "svg_labels.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+namespace svg
+{
+
+    using namespace std::literals;
+
+    namespace
+    {
+        // Читает очередной символ строки в кодировке UTF-8.
+        // Некорректные байты читаются как отдельные символы
+        char32_t NextCodePoint(std::string_view text, std::size_t &pos)
+        {
+            const auto lead = static_cast<unsigned char>(text[pos++]);
+            std::size_t length = 0;
+            char32_t code = lead;
+            if ((lead & 0xE0) == 0xC0)
+            {
+                length = 1;
+                code = lead & 0x1F;
+            }
+            else if ((lead & 0xF0) == 0xE0)
+            {
+                length = 2;
+                code = lead & 0x0F;
+            }
+            else if ((lead & 0xF8) == 0xF0)
+            {
+                length = 3;
+                code = lead & 0x07;
+            }
+            if (pos + length > text.size())
+            {
+                return lead;
+            }
+            for (std::size_t i = 0; i < length; ++i)
+            {
+                const auto next = static_cast<unsigned char>(text[pos + i]);
+                if ((next & 0xC0) != 0x80)
+                {
+                    return lead;
+                }
+                code = (code << 6) | (next & 0x3F);
+            }
+            pos += length;
+            return code;
+        }
+
+        std::string_view Trim(std::string_view sv)
+        {
+            while (!sv.empty() && std::isspace(static_cast<unsigned char>(sv.front())))
+            {
+                sv.remove_prefix(1);
+            }
+            while (!sv.empty() && std::isspace(static_cast<unsigned char>(sv.back())))
+            {
+                sv.remove_suffix(1);
+            }
+            return sv;
+        }
+
+        // Разбирает код символа: десятичный или шестнадцатеричный с префиксом 0x или U+
+        bool ParseCodePoint(std::string_view text, char32_t &code)
+        {
+            unsigned base = 10;
+            if (text.size() > 2 && (text.substr(0, 2) == "0x"sv || text.substr(0, 2) == "0X"sv ||
+                                    text.substr(0, 2) == "U+"sv || text.substr(0, 2) == "u+"sv))
+            {
+                base = 16;
+                text.remove_prefix(2);
+            }
+            if (text.empty())
+            {
+                return false;
+            }
+            std::uint32_t value = 0;
+            for (const char c : text)
+            {
+                unsigned digit = base;
+                if (c >= '0' && c <= '9')
+                {
+                    digit = static_cast<unsigned>(c - '0');
+                }
+                else if (c >= 'a' && c <= 'f')
+                {
+                    digit = static_cast<unsigned>(c - 'a' + 10);
+                }
+                else if (c >= 'A' && c <= 'F')
+                {
+                    digit = static_cast<unsigned>(c - 'A' + 10);
+                }
+                if (digit >= base)
+                {
+                    return false;
+                }
+                value = value * base + digit;
+                if (value > 0x10FFFF)
+                {
+                    return false;
+                }
+            }
+            code = static_cast<char32_t>(value);
+            return true;
+        }
+
+        // Разбирает ширину символа. Вся строка должна быть конечным неотрицательным числом
+        bool ParseAdvance(const std::string &text, double &advance)
+        {
+            try
+            {
+                std::size_t end = 0;
+                advance = std::stod(text, &end);
+                return end == text.size() && std::isfinite(advance) && advance >= 0;
+            }
+            catch (const std::logic_error &)
+            {
+                return false;
+            }
+        }
+
+        // Число слотов хэша должно быть степенью двойки
+        constexpr std::size_t INITIAL_SLOTS = 1024;
+
+        // Подпись, задевающая больше ячеек, хранится в отдельном списке
+        constexpr std::int64_t MAX_CELLS_PER_LABEL = 64;
+
+        // Номера ячеек ограничены, чтобы помещаться в ключ хэша
+        constexpr double MIN_CELL_INDEX = std::numeric_limits<std::int32_t>::min();
+        constexpr double MAX_CELL_INDEX = std::numeric_limits<std::int32_t>::max();
+
+        bool Overlaps(const BoundingBox &lhs, const BoundingBox &rhs)
+        {
+            return lhs.min.x < rhs.max.x && rhs.min.x < lhs.max.x &&
+                   lhs.min.y < rhs.max.y && rhs.min.y < lhs.max.y;
+        }
+    } // namespace
+
+    // FontMetrics::Font
+
+    FontMetrics::Font::Font()
+    {
+        ascii_.fill(-1);
+    }
+
+    float FontMetrics::Font::Advance(char32_t code) const
+    {
+        if (code < ascii_.size())
+        {
+            return ascii_[code] < 0 ? default_advance_ : ascii_[code];
+        }
+        const auto it = other_.find(code);
+        return it == other_.end() ? default_advance_ : it->second;
+    }
+
+    double FontMetrics::Font::MeasureEm(std::string_view text) const
+    {
+        double width = 0;
+        std::size_t pos = 0;
+        while (pos < text.size())
+        {
+            const auto c = static_cast<unsigned char>(text[pos]);
+            if (c < 0x80)
+            {
+                width += Advance(c);
+                ++pos;
+            }
+            else
+            {
+                width += Advance(NextCodePoint(text, pos));
+            }
+        }
+        return width;
+    }
+
+    // FontMetrics
+
+    FontMetrics FontMetrics::Load(std::istream &in)
+    {
+        FontMetrics metrics;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            const std::string_view sv = Trim(line);
+            if (sv.empty() || sv.front() == '#')
+            {
+                continue;
+            }
+            const std::size_t first = sv.find(';');
+            const std::size_t second = first == std::string_view::npos ? first : sv.find(';', first + 1);
+            if (second == std::string_view::npos)
+            {
+                throw std::invalid_argument("Bad font metrics line: "s + line);
+            }
+            const std::string_view family = Trim(sv.substr(0, first));
+            const std::string_view code = Trim(sv.substr(first + 1, second - first - 1));
+            double advance = 0;
+            char32_t code_point = 0;
+            if (!ParseAdvance(std::string(Trim(sv.substr(second + 1))), advance) ||
+                (code != "*"sv && !ParseCodePoint(code, code_point)))
+            {
+                throw std::invalid_argument("Bad font metrics line: "s + line);
+            }
+            if (code == "*"sv)
+            {
+                metrics.SetDefaultAdvance(family, advance);
+            }
+            else
+            {
+                metrics.SetAdvance(family, code_point, advance);
+            }
+        }
+        return metrics;
+    }
+
+    void FontMetrics::SetAdvance(std::string_view family, char32_t code, double advance)
+    {
+        Font &font = GetOrAddFont(family);
+        if (code < font.ascii_.size())
+        {
+            font.ascii_[code] = static_cast<float>(advance);
+        }
+        else
+        {
+            font.other_[code] = static_cast<float>(advance);
+        }
+    }
+
+    void FontMetrics::SetDefaultAdvance(std::string_view family, double advance)
+    {
+        GetOrAddFont(family).default_advance_ = static_cast<float>(advance);
+    }
+
+    const FontMetrics::Font &FontMetrics::GetFont(std::string_view family) const
+    {
+        const auto it = fonts_.find(std::string(family));
+        return it == fonts_.end() ? fallback_ : it->second;
+    }
+
+    double FontMetrics::MeasureEm(std::string_view family, std::string_view text) const
+    {
+        return GetFont(family).MeasureEm(text);
+    }
+
+    FontMetrics::Font &FontMetrics::GetOrAddFont(std::string_view family)
+    {
+        if (family == "*"sv)
+        {
+            return fallback_;
+        }
+        return fonts_[std::string(family)];
+    }
+
+    // LabelLayout
+
+    LabelLayout::LabelLayout(const FontMetrics &metrics, ObjectContainer &target, Policy policy, double cell_size)
+        : metrics_(metrics), target_(target), policy_(policy), cell_size_(cell_size), slots_(INITIAL_SLOTS)
+    {
+        if (!(cell_size > 0) || !std::isfinite(cell_size))
+        {
+            throw std::invalid_argument("Label layout cell size must be positive"s);
+        }
+    }
+
+    bool LabelLayout::Place(Text label)
+    {
+        const std::string &family = label.GetFontFamily();
+        if (last_font_ == nullptr || family != last_family_)
+        {
+            last_family_ = family;
+            last_font_ = &metrics_.GetFont(family);
+        }
+        const double width_em = last_font_->MeasureEm(label.GetData());
+        const BoundingBox box = label.GetExtent(width_em);
+        if (!std::isfinite(box.min.x) || !std::isfinite(box.min.y) ||
+            !std::isfinite(box.max.x) || !std::isfinite(box.max.y))
+        {
+            ++rejected_;
+            return false;
+        }
+
+        if (IsFree(box))
+        {
+            Occupy(box);
+            target_.Add(std::move(label));
+            return true;
+        }
+
+        if (policy_ == Policy::OFFSET)
+        {
+            const double width = box.max.x - box.min.x;
+            const double height = box.max.y - box.min.y;
+            const Point shifts[] = {{0, -height}, {0, height}, {width, 0}, {-width, 0}};
+            for (const Point shift : shifts)
+            {
+                const BoundingBox moved{{box.min.x + shift.x, box.min.y + shift.y},
+                                        {box.max.x + shift.x, box.max.y + shift.y}};
+                if (IsFree(moved))
+                {
+                    Occupy(moved);
+                    const Point offset = label.GetOffset();
+                    label.SetOffset({offset.x + shift.x, offset.y + shift.y});
+                    target_.Add(std::move(label));
+                    return true;
+                }
+            }
+        }
+
+        ++rejected_;
+        return false;
+    }
+
+    bool LabelLayout::IsFree(const BoundingBox &box) const
+    {
+        for (const BoundingBox &other : large_)
+        {
+            if (Overlaps(other, box))
+            {
+                return false;
+            }
+        }
+
+        const CellRange cells = GetCells(box);
+        if (IsLarge(cells))
+        {
+            // Большая подпись сравнивается со всеми размещёнными
+            for (const Entry &entry : entries_)
+            {
+                if (Overlaps(entry.box, box))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        return ForEachCell(cells, [this, &box](std::uint64_t key)
+                           {
+                               for (std::uint32_t entry = slots_[FindSlot(key)].head; entry != NO_ENTRY; entry = entries_[entry].next)
+                               {
+                                   if (Overlaps(entries_[entry].box, box))
+                                   {
+                                       return false;
+                                   }
+                               }
+                               return true; });
+    }
+
+    void LabelLayout::Occupy(const BoundingBox &box)
+    {
+        ++placed_;
+        const CellRange cells = GetCells(box);
+        if (IsLarge(cells))
+        {
+            large_.push_back(box);
+            return;
+        }
+
+        ForEachCell(cells, [this, &box](std::uint64_t key)
+                    {
+                        // Заполненность хэша держится не выше половины
+                        if (2 * (used_slots_ + 1) > slots_.size())
+                        {
+                            Grow();
+                        }
+                        Slot &slot = slots_[FindSlot(key)];
+                        if (slot.head == NO_ENTRY)
+                        {
+                            slot.key = key;
+                            ++used_slots_;
+                        }
+                        entries_.push_back({box, slot.head});
+                        slot.head = static_cast<std::uint32_t>(entries_.size() - 1);
+                        return true; });
+    }
+
+    LabelLayout::CellRange LabelLayout::GetCells(const BoundingBox &box) const
+    {
+        return {CellIndex(box.min.x), CellIndex(box.min.y), CellIndex(box.max.x), CellIndex(box.max.y)};
+    }
+
+    // Номер ячейки, в которую попадает координата.
+    // Далёкие координаты попадают в крайние ячейки, что не нарушает проверку пересечений
+    std::int64_t LabelLayout::CellIndex(double coordinate) const
+    {
+        const double index = std::floor(coordinate / cell_size_);
+        return static_cast<std::int64_t>(std::clamp(index, MIN_CELL_INDEX, MAX_CELL_INDEX));
+    }
+
+    bool LabelLayout::IsLarge(const CellRange &cells)
+    {
+        const std::int64_t columns = cells.x1 - cells.x0 + 1;
+        const std::int64_t rows = cells.y1 - cells.y0 + 1;
+        return columns > MAX_CELLS_PER_LABEL || rows > MAX_CELLS_PER_LABEL ||
+               columns * rows > MAX_CELLS_PER_LABEL;
+    }
+
+    // Вызывает action для ключа каждой ячейки из cells,
+    // пока action возвращает true
+    template <typename Action>
+    bool LabelLayout::ForEachCell(const CellRange &cells, Action action)
+    {
+        for (std::int64_t y = cells.y0; y <= cells.y1; ++y)
+        {
+            for (std::int64_t x = cells.x0; x <= cells.x1; ++x)
+            {
+                if (!action(CellKey(x, y)))
+                {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    std::uint64_t LabelLayout::CellKey(std::int64_t x, std::int64_t y)
+    {
+        return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) |
+               static_cast<std::uint32_t>(y);
+    }
+
+    // Возвращает слот с ключом key или пустой слот, в который его следует поместить
+    std::size_t LabelLayout::FindSlot(std::uint64_t key) const
+    {
+        const std::size_t mask = slots_.size() - 1;
+        std::size_t index = static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+        while (slots_[index].head != NO_ENTRY && slots_[index].key != key)
+        {
+            index = (index + 1) & mask;
+        }
+        return index;
+    }
+
+    void LabelLayout::Grow()
+    {
+        std::vector<Slot> old = std::move(slots_);
+        slots_.assign(old.size() * 2, Slot{});
+        for (const Slot &slot : old)
+        {
+            if (slot.head != NO_ENTRY)
+            {
+                slots_[FindSlot(slot.key)] = slot;
+            }
+        }
+    }
+
+} // namespace svg
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "svg.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace svg
+{
+
+    /*
+     * Ширины символов шрифтов в долях размера шрифта (em).
+     * Таблица загружается из текстового потока, каждая строка которого имеет вид
+     *     семейство;код символа;ширина
+     * Код символа записывается десятичным числом или шестнадцатеричным с префиксом 0x или U+.
+     * Вместо кода символа можно указать *, тогда ширина используется для символов,
+     * отсутствующих в таблице. Семейство * задаёт ширины для неизвестных шрифтов.
+     * Пустые строки и строки, начинающиеся с #, пропускаются
+     */
+    class FontMetrics
+    {
+    public:
+        // Ширина символа, если о шрифте ничего не известно
+        static constexpr double DEFAULT_ADVANCE = 0.6;
+
+        /*
+         * Ширины символов одного шрифта
+         */
+        class Font
+        {
+        public:
+            Font();
+
+            // Возвращает ширину строки в кодировке UTF-8 в долях размера шрифта
+            double MeasureEm(std::string_view text) const;
+
+        private:
+            friend class FontMetrics;
+
+            float Advance(char32_t code) const;
+
+            std::array<float, 128> ascii_;
+            std::unordered_map<char32_t, float> other_;
+            float default_advance_ = static_cast<float>(DEFAULT_ADVANCE);
+        };
+
+        static FontMetrics Load(std::istream &in);
+
+        // Задаёт ширину символа code в шрифте family
+        void SetAdvance(std::string_view family, char32_t code, double advance);
+
+        // Задаёт ширину символов шрифта family, отсутствующих в таблице
+        void SetDefaultAdvance(std::string_view family, double advance);
+
+        // Возвращает шрифт family или шрифт для неизвестных семейств
+        const Font &GetFont(std::string_view family) const;
+
+        // Возвращает ширину строки в кодировке UTF-8 в долях размера шрифта
+        double MeasureEm(std::string_view family, std::string_view text) const;
+
+    private:
+        Font &GetOrAddFont(std::string_view family);
+
+        std::unordered_map<std::string, Font> fonts_;
+        Font fallback_;
+    };
+
+    /*
+     * Размещает текстовые подписи так, чтобы они не перекрывались.
+     * Подпись, для которой нашлось место, добавляется в контейнер,
+     * остальные отбрасываются. Занятые области хранятся в пространственном хэше
+     */
+    class LabelLayout
+    {
+    public:
+        enum class Policy
+        {
+            // Подпись, задевающая уже размещённые, отбрасывается
+            REMOVE,
+            // Подпись пробуется сдвинуть вверх, вниз, вправо и влево на свой размер
+            OFFSET,
+        };
+
+        // cell_size задаёт сторону ячейки хэша и должен быть положительным
+        // числом порядка размера подписи
+        LabelLayout(const FontMetrics &metrics, ObjectContainer &target,
+                    Policy policy = Policy::REMOVE, double cell_size = 64);
+
+        // Добавляет подпись в контейнер, если для неё нашлось свободное место
+        bool Place(Text label);
+
+        std::size_t PlacedCount() const
+        {
+            return placed_;
+        }
+
+        std::size_t RejectedCount() const
+        {
+            return rejected_;
+        }
+
+    private:
+        static constexpr std::uint32_t NO_ENTRY = static_cast<std::uint32_t>(-1);
+
+        // Ячейка хэша с открытой адресацией и головой списка её подписей
+        struct Slot
+        {
+            std::uint64_t key = 0;
+            std::uint32_t head = NO_ENTRY;
+        };
+
+        // Занятая подпись в списке ячейки
+        struct Entry
+        {
+            BoundingBox box;
+            std::uint32_t next;
+        };
+
+        // Прямоугольник ячеек [x0, x1] x [y0, y1]
+        struct CellRange
+        {
+            std::int64_t x0, y0, x1, y1;
+        };
+
+        bool IsFree(const BoundingBox &box) const;
+        void Occupy(const BoundingBox &box);
+
+        CellRange GetCells(const BoundingBox &box) const;
+        std::int64_t CellIndex(double coordinate) const;
+        static bool IsLarge(const CellRange &cells);
+
+        template <typename Action>
+        static bool ForEachCell(const CellRange &cells, Action action);
+
+        static std::uint64_t CellKey(std::int64_t x, std::int64_t y);
+        std::size_t FindSlot(std::uint64_t key) const;
+        void Grow();
+
+        const FontMetrics &metrics_;
+        ObjectContainer &target_;
+
+        // Подписи обычно набраны одним шрифтом, поэтому последний найденный запоминается
+        std::string last_family_;
+        const FontMetrics::Font *last_font_ = nullptr;
+
+        Policy policy_;
+        double cell_size_;
+
+        std::size_t placed_ = 0;
+        std::size_t rejected_ = 0;
+
+        std::vector<Slot> slots_;
+        std::size_t used_slots_ = 0;
+        std::vector<Entry> entries_;
+        // Подписи, задевающие слишком много ячеек, проверяются перебором
+        std::vector<BoundingBox> large_;
+    };
+
+} // namespace svg
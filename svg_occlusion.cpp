@@ -0,0 +1,320 @@
+#include "svg_occlusion.h"
+
+#include "svg_sink.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace svg
+{
+
+    namespace
+    {
+        // Сетка ограничена этим числом ячеек на один непрозрачный круг
+        constexpr std::size_t CELLS_PER_OCCLUDER = 2;
+
+        // Круги, занимающие больше ячеек, проверяются отдельно,
+        // причём только самые большие из них
+        constexpr std::size_t MAX_CELLS_PER_OCCLUDER = 64;
+        constexpr std::size_t MAX_LARGE_OCCLUDERS = 64;
+
+        // Сколько ближайших по порядку вывода кругов проверяется для одного объекта
+        constexpr std::size_t MAX_CHECKS_PER_OBJECT = 64;
+
+        bool Contains(const Disk &disk, const BoundingBox &box)
+        {
+            const double dx = std::max(std::abs(box.min.x - disk.center.x), std::abs(box.max.x - disk.center.x));
+            const double dy = std::max(std::abs(box.min.y - disk.center.y), std::abs(box.max.y - disk.center.y));
+            return dx * dx + dy * dy <= disk.radius * disk.radius;
+        }
+
+        // Непрозрачный круг и номер его объекта в документе
+        struct Occluder
+        {
+            std::size_t index;
+            Disk disk;
+        };
+
+        // Объект, для которого проверяется перекрытие
+        struct Candidate
+        {
+            std::size_t index;
+            BoundingBox box;
+        };
+
+        /*
+         * Равномерная сетка, покрывающая все объекты документа
+         */
+        class Grid
+        {
+        public:
+            Grid(const BoundingBox &world, double cell_size, std::size_t max_cells)
+                : origin_(world.min), cell_size_(cell_size)
+            {
+                const double width = world.max.x - world.min.x;
+                const double height = world.max.y - world.min.y;
+                double columns = std::floor(width / cell_size_) + 1;
+                double rows = std::floor(height / cell_size_) + 1;
+                if (columns * rows > static_cast<double>(max_cells))
+                {
+                    cell_size_ *= std::sqrt(columns * rows / static_cast<double>(max_cells));
+                    columns = std::floor(width / cell_size_) + 1;
+                    rows = std::floor(height / cell_size_) + 1;
+                }
+                columns_ = static_cast<std::size_t>(columns);
+                rows_ = static_cast<std::size_t>(rows);
+            }
+
+            std::size_t Size() const
+            {
+                return columns_ * rows_;
+            }
+
+            std::size_t Column(double x) const
+            {
+                return Clamp((x - origin_.x) / cell_size_, columns_);
+            }
+
+            std::size_t Row(double y) const
+            {
+                return Clamp((y - origin_.y) / cell_size_, rows_);
+            }
+
+            std::size_t Cell(std::size_t column, std::size_t row) const
+            {
+                return row * columns_ + column;
+            }
+
+        private:
+            static std::size_t Clamp(double index, std::size_t size)
+            {
+                if (!(index > 0))
+                {
+                    return 0;
+                }
+                return std::min(static_cast<std::size_t>(index), size - 1);
+            }
+
+            Point origin_;
+            double cell_size_;
+            std::size_t columns_ = 1;
+            std::size_t rows_ = 1;
+        };
+
+        /*
+         * Элементы, разложенные по ячейкам сетки подряд в одном массиве.
+         * Внутри ячейки элементы идут в порядке добавления
+         */
+        template <typename Item>
+        class Buckets
+        {
+        public:
+            explicit Buckets(std::size_t cells)
+                : offsets_(cells + 1)
+            {
+            }
+
+            // Первый проход: подсчёт числа элементов в ячейке
+            void Count(std::size_t cell)
+            {
+                ++offsets_[cell + 1];
+            }
+
+            // Между проходами: выделение памяти под элементы
+            void Allocate()
+            {
+                for (std::size_t i = 1; i < offsets_.size(); ++i)
+                {
+                    offsets_[i] += offsets_[i - 1];
+                }
+                items_.resize(offsets_.back());
+                next_.assign(offsets_.begin(), offsets_.end() - 1);
+            }
+
+            // Второй проход: размещение элементов
+            void Put(std::size_t cell, const Item &item)
+            {
+                items_[next_[cell]++] = item;
+            }
+
+            const Item *Begin(std::size_t cell) const
+            {
+                return items_.data() + offsets_[cell];
+            }
+
+            const Item *End(std::size_t cell) const
+            {
+                return items_.data() + offsets_[cell + 1];
+            }
+
+        private:
+            std::vector<std::size_t> offsets_;
+            std::vector<std::size_t> next_;
+            std::vector<Item> items_;
+        };
+
+        // Вызывает action для каждой ячейки, которую задевает круг.
+        // Возвращает false, если ячеек слишком много
+        template <typename Action>
+        bool ForEachCell(const Grid &grid, const Disk &disk, Action action)
+        {
+            const std::size_t x0 = grid.Column(disk.center.x - disk.radius);
+            const std::size_t x1 = grid.Column(disk.center.x + disk.radius);
+            const std::size_t y0 = grid.Row(disk.center.y - disk.radius);
+            const std::size_t y1 = grid.Row(disk.center.y + disk.radius);
+            if ((x1 - x0 + 1) * (y1 - y0 + 1) > MAX_CELLS_PER_OCCLUDER)
+            {
+                return false;
+            }
+            for (std::size_t y = y0; y <= y1; ++y)
+            {
+                for (std::size_t x = x0; x <= x1; ++x)
+                {
+                    action(grid.Cell(x, y));
+                }
+            }
+            return true;
+        }
+
+        // Ячейка, в которой лежит центр прямоугольника.
+        // Круг, закрывающий прямоугольник, обязательно задевает эту ячейку
+        std::size_t CenterCell(const Grid &grid, const BoundingBox &box)
+        {
+            return grid.Cell(grid.Column((box.min.x + box.max.x) / 2), grid.Row((box.min.y + box.max.y) / 2));
+        }
+
+        // Проверяет, закрыт ли объект одним из кругов, выводимых после него
+        bool IsCovered(const Candidate &candidate, const Occluder *begin, const Occluder *end)
+        {
+            const Occluder *it = std::upper_bound(begin, end, candidate.index, [](std::size_t index, const Occluder &occluder)
+                                                  { return index < occluder.index; });
+            for (std::size_t checks = 0; it != end && checks < MAX_CHECKS_PER_OBJECT; ++it, ++checks)
+            {
+                if (Contains(it->disk, candidate.box))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    } // namespace
+
+    OcclusionStats RemoveOccludedObjects(Document &doc)
+    {
+        const auto &objects = doc.GetObjects();
+
+        std::vector<Candidate> candidates;
+        std::vector<Occluder> occluders;
+        std::optional<BoundingBox> world;
+        double diameters = 0;
+        for (std::size_t i = 0; i < objects.size(); ++i)
+        {
+            const auto box = objects[i]->GetBounds();
+            if (!box)
+            {
+                continue;
+            }
+            candidates.push_back({i, *box});
+            if (!world)
+            {
+                world = box;
+            }
+            world->min = {std::min(world->min.x, box->min.x), std::min(world->min.y, box->min.y)};
+            world->max = {std::max(world->max.x, box->max.x), std::max(world->max.y, box->max.y)};
+            if (const auto disk = objects[i]->GetOpaqueDisk())
+            {
+                occluders.push_back({i, *disk});
+                diameters += 2 * disk->radius;
+            }
+        }
+        if (occluders.empty())
+        {
+            return {};
+        }
+
+        // Ячейка размером с типичный круг, но не больше CELLS_PER_OCCLUDER ячеек на круг
+        const Grid grid{*world, diameters / static_cast<double>(occluders.size()), occluders.size() * CELLS_PER_OCCLUDER};
+
+        // Объекты и круги раскладываются по ячейкам в порядке вывода, после чего
+        // каждая ячейка обрабатывается независимо от других
+        Buckets<Occluder> cell_occluders{grid.Size()};
+        std::vector<Occluder> large;
+        for (const Occluder &occluder : occluders)
+        {
+            if (!ForEachCell(grid, occluder.disk, [&](std::size_t cell)
+                             { cell_occluders.Count(cell); }))
+            {
+                large.push_back(occluder);
+            }
+        }
+        cell_occluders.Allocate();
+        for (const Occluder &occluder : occluders)
+        {
+            ForEachCell(grid, occluder.disk, [&](std::size_t cell)
+                        { cell_occluders.Put(cell, occluder); });
+        }
+
+        if (large.size() > MAX_LARGE_OCCLUDERS)
+        {
+            std::partial_sort(large.begin(), large.begin() + MAX_LARGE_OCCLUDERS, large.end(),
+                              [](const Occluder &lhs, const Occluder &rhs)
+                              { return lhs.disk.radius > rhs.disk.radius; });
+            large.resize(MAX_LARGE_OCCLUDERS);
+        }
+        std::sort(large.begin(), large.end(), [](const Occluder &lhs, const Occluder &rhs)
+                  { return lhs.index < rhs.index; });
+
+        Buckets<Candidate> cell_candidates{grid.Size()};
+        for (const Candidate &candidate : candidates)
+        {
+            cell_candidates.Count(CenterCell(grid, candidate.box));
+        }
+        cell_candidates.Allocate();
+        for (const Candidate &candidate : candidates)
+        {
+            cell_candidates.Put(CenterCell(grid, candidate.box), candidate);
+        }
+
+        std::vector<bool> remove(objects.size());
+        bool any_removed = false;
+        for (std::size_t cell = 0; cell < grid.Size(); ++cell)
+        {
+            const Occluder *begin = cell_occluders.Begin(cell);
+            const Occluder *end = cell_occluders.End(cell);
+            for (const Candidate *it = cell_candidates.Begin(cell); it != cell_candidates.End(cell); ++it)
+            {
+                if (IsCovered(*it, begin, end) || IsCovered(*it, large.data(), large.data() + large.size()))
+                {
+                    remove[it->index] = true;
+                    any_removed = true;
+                }
+            }
+        }
+        if (!any_removed)
+        {
+            return {};
+        }
+
+        // Размер считается с тем же отступом, что и в Document::Render
+        OcclusionStats stats;
+        CountingSink sink;
+        std::ostream out{&sink};
+        const RenderContext ctx{out, 2, 2};
+        for (std::size_t i = 0; i < objects.size(); ++i)
+        {
+            if (remove[i])
+            {
+                objects[i]->Render(ctx);
+                ++stats.removed_objects;
+            }
+        }
+        stats.removed_bytes = sink.Size();
+
+        doc.RemoveObjects(remove);
+        return stats;
+    }
+
+} // namespace svg
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "svg.h"
+
+#include <cstddef>
+
+namespace svg
+{
+
+    // Результат удаления перекрытых объектов
+    struct OcclusionStats
+    {
+        // Сколько объектов удалено
+        std::size_t removed_objects = 0;
+        // Сколько байт занимало их svg-представление в документе
+        std::size_t removed_bytes = 0;
+    };
+
+    /*
+     * Удаляет из документа объекты, которые целиком закрыты одним из следующих
+     * за ними непрозрачно залитых кругов. Объекты без известных границ, например
+     * текст, не удаляются. Внешний вид документа при этом не меняется
+     */
+    OcclusionStats RemoveOccludedObjects(Document &doc);
+
+} // namespace svg
@@ -0,0 +1,285 @@
+#include "svg_sink.h"
+
+#include <cerrno>
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include <system_error>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace svg
+{
+
+    // CountingSink
+
+    CountingSink::CountingSink()
+    {
+        setp(scratch_, scratch_ + sizeof(scratch_));
+    }
+
+    void CountingSink::WriteRef(std::string_view bytes)
+    {
+        size_ += bytes.size();
+    }
+
+    void CountingSink::Flush()
+    {
+    }
+
+    std::size_t CountingSink::Size() const
+    {
+        return size_ + static_cast<std::size_t>(pptr() - pbase());
+    }
+
+    CountingSink::int_type CountingSink::overflow(int_type ch)
+    {
+        size_ += static_cast<std::size_t>(pptr() - pbase());
+        setp(scratch_, scratch_ + sizeof(scratch_));
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            ++size_;
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize CountingSink::xsputn(const char *, std::streamsize count)
+    {
+        size_ += static_cast<std::size_t>(count);
+        return count;
+    }
+
+    std::size_t MeasureRender(const Document &doc)
+    {
+        CountingSink sink;
+        doc.Render(sink);
+        return sink.Size();
+    }
+
+#ifndef _WIN32
+
+    namespace
+    {
+        constexpr std::size_t BLOCK_SIZE = 64 * 1024;
+
+        // Объём, после которого накопленный вывод записывается, не дожидаясь Flush
+        constexpr std::size_t MAX_BUFFERED = 1024 * 1024;
+
+        // Короткие фрагменты дешевле скопировать в блок, чем передавать отдельным iovec
+        constexpr std::size_t MIN_REF_SIZE = 64;
+
+#ifdef IOV_MAX
+        constexpr std::size_t MAX_SEGMENTS = IOV_MAX;
+#else
+        constexpr std::size_t MAX_SEGMENTS = 16;
+#endif
+    } // namespace
+
+    // WritevSink
+
+    WritevSink::WritevSink(int fd)
+        : fd_(fd)
+    {
+    }
+
+    void WritevSink::WriteRef(std::string_view bytes)
+    {
+        if (bytes.size() < MIN_REF_SIZE)
+        {
+            OutputSink::WriteRef(bytes);
+            return;
+        }
+        CloseSegment();
+        AddSegment(bytes.data(), bytes.size());
+        if (WriteIfFull())
+        {
+            StartBlock();
+        }
+    }
+
+    void WritevSink::Flush()
+    {
+        CloseSegment();
+        WriteAll();
+        used_blocks_ = 0;
+        setp(nullptr, nullptr);
+        segment_begin_ = nullptr;
+    }
+
+    WritevSink::int_type WritevSink::overflow(int_type ch)
+    {
+        CloseSegment();
+        WriteIfFull();
+        StartBlock();
+        if (!traits_type::eq_int_type(ch, traits_type::eof()))
+        {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    void WritevSink::CloseSegment()
+    {
+        if (pptr() != segment_begin_)
+        {
+            AddSegment(segment_begin_, static_cast<std::size_t>(pptr() - segment_begin_));
+        }
+        segment_begin_ = pptr();
+    }
+
+    void WritevSink::AddSegment(const char *data, std::size_t size)
+    {
+        // Продолжение предыдущего фрагмента расширяет его
+        if (!segments_.empty())
+        {
+            iovec &last = segments_.back();
+            if (static_cast<const char *>(last.iov_base) + last.iov_len == data)
+            {
+                last.iov_len += size;
+                buffered_ += size;
+                return;
+            }
+        }
+        segments_.push_back({const_cast<char *>(data), size});
+        buffered_ += size;
+    }
+
+    bool WritevSink::WriteIfFull()
+    {
+        if (buffered_ < MAX_BUFFERED && segments_.size() < MAX_SEGMENTS)
+        {
+            return false;
+        }
+        WriteAll();
+        used_blocks_ = 0;
+        return true;
+    }
+
+    void WritevSink::StartBlock()
+    {
+        if (used_blocks_ == blocks_.size())
+        {
+            blocks_.push_back(std::make_unique<char[]>(BLOCK_SIZE));
+        }
+        char *block = blocks_[used_blocks_++].get();
+        setp(block, block + BLOCK_SIZE);
+        segment_begin_ = block;
+    }
+
+    void WritevSink::WriteAll()
+    {
+        std::size_t first = 0;
+        while (first < segments_.size())
+        {
+            const std::size_t count = std::min(segments_.size() - first, MAX_SEGMENTS);
+            const ssize_t written = ::writev(fd_, &segments_[first], static_cast<int>(count));
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                // Записанные фрагменты удаляются, чтобы следующий Flush не повторил их
+                const int err = errno;
+                segments_.erase(segments_.begin(), segments_.begin() + static_cast<std::ptrdiff_t>(first));
+                throw std::system_error(err, std::generic_category(), "writev");
+            }
+
+            // Пропускаем полностью записанные фрагменты и сдвигаем частично записанный
+            buffered_ -= static_cast<std::size_t>(written);
+            std::size_t left = static_cast<std::size_t>(written);
+            while (first < segments_.size() && left >= segments_[first].iov_len)
+            {
+                left -= segments_[first].iov_len;
+                ++first;
+            }
+            if (left > 0)
+            {
+                iovec &partial = segments_[first];
+                partial.iov_base = static_cast<char *>(partial.iov_base) + left;
+                partial.iov_len -= left;
+            }
+        }
+        segments_.clear();
+        buffered_ = 0;
+    }
+
+    // MmapFileSink
+
+    MmapFileSink::MmapFileSink(const std::string &path, std::size_t size)
+        : capacity_(size)
+    {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "open " + path);
+        }
+        if (size == 0)
+        {
+            return;
+        }
+        if (::ftruncate(fd_, static_cast<off_t>(size)) != 0)
+        {
+            const int err = errno;
+            ::close(fd_);
+            throw std::system_error(err, std::generic_category(), "ftruncate " + path);
+        }
+        void *data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (data == MAP_FAILED)
+        {
+            const int err = errno;
+            ::close(fd_);
+            throw std::system_error(err, std::generic_category(), "mmap " + path);
+        }
+        data_ = static_cast<char *>(data);
+        setp(data_, data_ + size);
+    }
+
+    MmapFileSink::~MmapFileSink()
+    {
+        if (data_ != nullptr)
+        {
+            ::munmap(data_, capacity_);
+        }
+        ::close(fd_);
+    }
+
+    void MmapFileSink::Flush()
+    {
+        if (overflowed_)
+        {
+            throw std::length_error("Output does not fit into the mapped file");
+        }
+        // Область записи закрывается до обрезки файла, чтобы за его концом
+        // не оставалось доступных для записи страниц
+        setp(pptr(), pptr());
+        flushed_ = true;
+        if (Size() != capacity_ && ::ftruncate(fd_, static_cast<off_t>(Size())) != 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "ftruncate");
+        }
+    }
+
+    std::size_t MmapFileSink::Size() const
+    {
+        return static_cast<std::size_t>(pptr() - data_);
+    }
+
+    MmapFileSink::int_type MmapFileSink::overflow(int_type)
+    {
+        if (flushed_)
+        {
+            throw std::logic_error("Write to MmapFileSink after Flush");
+        }
+        overflowed_ = true;
+        throw std::length_error("Output does not fit into the mapped file");
+    }
+
+#endif
+
+} // namespace svg
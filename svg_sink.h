@@ -0,0 +1,115 @@
+#pragma once
+
+#include "svg.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#endif
+
+namespace svg
+{
+
+    /*
+     * Приёмник, который только подсчитывает размер вывода.
+     * Используется для предварительного прохода перед выводом в файл заданного размера
+     */
+    class CountingSink final : public OutputSink
+    {
+    public:
+        CountingSink();
+
+        void WriteRef(std::string_view bytes) override;
+        void Flush() override;
+
+        std::size_t Size() const;
+
+    protected:
+        int_type overflow(int_type ch) override;
+        std::streamsize xsputn(const char *s, std::streamsize count) override;
+
+    private:
+        char scratch_[256];
+        std::size_t size_ = 0;
+    };
+
+    // Возвращает размер svg-представления документа в байтах
+    std::size_t MeasureRender(const Document &doc);
+
+#ifndef _WIN32
+
+    /*
+     * Приёмник, собирающий вывод в список фрагментов и записывающий их
+     * в файловый дескриптор системным вызовом writev.
+     * Форматированный вывод попадает в блоки памяти приёмника,
+     * а байты из WriteRef передаются ядру без копирования
+     */
+    class WritevSink final : public OutputSink
+    {
+    public:
+        // Дескриптор не закрывается приёмником
+        explicit WritevSink(int fd);
+
+        void WriteRef(std::string_view bytes) override;
+        void Flush() override;
+
+    protected:
+        int_type overflow(int_type ch) override;
+
+    private:
+        // Завершает текущий фрагмент в блоке и добавляет его в список
+        void CloseSegment();
+        void AddSegment(const char *data, std::size_t size);
+        // Записывает накопленное, если буфер или список фрагментов заполнены
+        bool WriteIfFull();
+        void StartBlock();
+        void WriteAll();
+
+        int fd_;
+        std::vector<std::unique_ptr<char[]>> blocks_;
+        std::size_t used_blocks_ = 0;
+        char *segment_begin_ = nullptr;
+        std::vector<iovec> segments_;
+        std::size_t buffered_ = 0;
+    };
+
+    /*
+     * Приёмник, записывающий вывод прямо в отображённый в память файл.
+     * Размер файла задаётся заранее, например с помощью MeasureRender.
+     * Запись сверх этого размера выбрасывает std::length_error.
+     * При сбросе файл обрезается до фактического размера вывода.
+     * Приёмник одноразовый: запись после Flush выбрасывает std::logic_error
+     */
+    class MmapFileSink final : public OutputSink
+    {
+    public:
+        MmapFileSink(const std::string &path, std::size_t size);
+        ~MmapFileSink() override;
+
+        MmapFileSink(const MmapFileSink &) = delete;
+        MmapFileSink &operator=(const MmapFileSink &) = delete;
+
+        void Flush() override;
+
+        // Возвращает число записанных байт
+        std::size_t Size() const;
+
+    protected:
+        int_type overflow(int_type ch) override;
+
+    private:
+        int fd_ = -1;
+        char *data_ = nullptr;
+        std::size_t capacity_ = 0;
+        bool overflowed_ = false;
+        bool flushed_ = false;
+    };
+
+#endif
+
+} // namespace svg
@@ -0,0 +1,279 @@
+#include "svg_template.h"
+
+#include <stdexcept>
+
+namespace svg
+{
+
+    using namespace std::literals;
+
+    namespace
+    {
+        // Границы заглушки. Управляющие символы не экранируются при выводе
+        // и не встречаются в обычных значениях атрибутов и текста
+        constexpr char HOLE_BEGIN = '\x01';
+        constexpr char HOLE_END = '\x02';
+
+        // Тип параметра записывается в заглушке сразу после её начала
+        constexpr char TEXT_HOLE = 't';
+        constexpr char COLOR_HOLE = 'c';
+
+        // Так выводится центр круга по умолчанию: cx="0" cy="0"
+        constexpr std::string_view DEFAULT_CENTER = "0\" cy=\"0"sv;
+
+        // Цвет по умолчанию совпадает с NoneColor, чтобы атрибут не оставался пустым
+        constexpr std::string_view DEFAULT_COLOR = "none"sv;
+
+        std::string MakeHole(char kind, std::string_view name)
+        {
+            std::string ret;
+            ret.reserve(name.size() + 3);
+            ret.push_back(HOLE_BEGIN);
+            ret.push_back(kind);
+            ret.append(name);
+            ret.push_back(HOLE_END);
+            return ret;
+        }
+    } // namespace
+
+    std::string TextHole(std::string_view name)
+    {
+        return MakeHole(TEXT_HOLE, name);
+    }
+
+    std::string ColorHole(std::string_view name)
+    {
+        return MakeHole(COLOR_HOLE, name);
+    }
+
+    // DocumentTemplate::Holes
+
+    std::size_t DocumentTemplate::Holes::Find(std::string_view name) const
+    {
+        for (std::size_t i = 0; i < names.size(); ++i)
+        {
+            if (names[i] == name)
+            {
+                return i;
+            }
+        }
+        return NO_HOLE;
+    }
+
+    // DocumentTemplate::Arguments
+
+    DocumentTemplate::Arguments::Arguments(const DocumentTemplate &owner)
+        : holes_(owner.holes_), values_(holes_->names.size())
+    {
+        for (std::size_t i = 0; i < values_.size(); ++i)
+        {
+            if (holes_->kinds[i] == HoleKind::CENTER)
+            {
+                values_[i] = DEFAULT_CENTER;
+            }
+            else if (holes_->kinds[i] == HoleKind::COLOR)
+            {
+                values_[i] = DEFAULT_COLOR;
+            }
+        }
+    }
+
+    DocumentTemplate::Arguments &DocumentTemplate::Arguments::SetText(std::string_view name, std::string_view text)
+    {
+        detail::HtmlEncodeString(Reset(), text);
+        Store(name, HoleKind::TEXT);
+        return *this;
+    }
+
+    DocumentTemplate::Arguments &DocumentTemplate::Arguments::SetColor(std::string_view name, const Color &color)
+    {
+        Reset() << color;
+        Store(name, HoleKind::COLOR);
+        return *this;
+    }
+
+    DocumentTemplate::Arguments &DocumentTemplate::Arguments::SetCenter(std::string_view name, Point center)
+    {
+        // Форматирование совпадает с Circle::RenderObject
+        Reset() << center.x << "\" cy=\""sv << center.y;
+        Store(name, HoleKind::CENTER);
+        return *this;
+    }
+
+    std::ostringstream &DocumentTemplate::Arguments::Reset()
+    {
+        buf_.str({});
+        return buf_;
+    }
+
+    void DocumentTemplate::Arguments::Store(std::string_view name, HoleKind kind)
+    {
+        const std::size_t hole = holes_->Find(name);
+        if (hole == NO_HOLE)
+        {
+            throw std::invalid_argument("Unknown template parameter: "s + std::string(name));
+        }
+        if (holes_->kinds[hole] != kind)
+        {
+            throw std::invalid_argument("Wrong value type for template parameter: "s + std::string(name));
+        }
+        values_[hole] = buf_.str();
+    }
+
+    // DocumentTemplate::Builder
+
+    void DocumentTemplate::Builder::AddPtr(std::unique_ptr<Object> &&obj)
+    {
+        entries_.push_back({std::move(obj), {}});
+    }
+
+    Circle &DocumentTemplate::Builder::AddCircle(std::string name, Circle circle)
+    {
+        auto object = std::make_unique<Circle>(std::move(circle));
+        Circle &ref = *object;
+        entries_.push_back({std::move(object), std::move(name)});
+        return ref;
+    }
+
+    DocumentTemplate DocumentTemplate::Builder::Build() const
+    {
+        DocumentTemplate ret;
+        auto holes = std::make_shared<Holes>();
+        std::ostringstream out;
+        detail::RenderDocumentHeader(out);
+        ret.AppendRendered(*holes, out.str());
+
+        for (const Entry &entry : entries_)
+        {
+            out.str({});
+            if (entry.center_hole.empty())
+            {
+                entry.object->Render(RenderContext{out, 2, 2});
+                ret.AppendRendered(*holes, out.str());
+                continue;
+            }
+
+            // Центр выводится со значением по умолчанию и заменяется параметром
+            Circle circle = static_cast<const Circle &>(*entry.object);
+            circle.SetCenter({0, 0});
+            circle.Render(RenderContext{out, 2, 2});
+            const std::string rendered = out.str();
+            const std::size_t center = rendered.find(DEFAULT_CENTER);
+            ret.AppendRendered(*holes, std::string_view(rendered).substr(0, center));
+            ret.AppendHole(FindOrAddHole(*holes, entry.center_hole, HoleKind::CENTER));
+            ret.AppendRendered(*holes, std::string_view(rendered).substr(center + DEFAULT_CENTER.size()));
+        }
+        ret.holes_ = std::move(holes);
+        return ret;
+    }
+
+    // DocumentTemplate
+
+    DocumentTemplate::Arguments DocumentTemplate::MakeArguments() const
+    {
+        return Arguments{*this};
+    }
+
+    void DocumentTemplate::Render(std::ostream &out, const Arguments &args) const
+    {
+        CheckArguments(args);
+        const char *data = bytes_.data();
+        for (const Piece &piece : pieces_)
+        {
+            out.write(data + piece.begin, static_cast<std::streamsize>(piece.end - piece.begin));
+            if (piece.hole != NO_HOLE)
+            {
+                const std::string &value = args.values_[piece.hole];
+                out.write(value.data(), static_cast<std::streamsize>(value.size()));
+            }
+        }
+        detail::RenderDocumentFooter(out);
+    }
+
+    void DocumentTemplate::Render(OutputSink &sink, const Arguments &args) const
+    {
+        CheckArguments(args);
+        const std::string_view bytes = bytes_;
+        for (const Piece &piece : pieces_)
+        {
+            sink.WriteRef(bytes.substr(piece.begin, piece.end - piece.begin));
+            if (piece.hole != NO_HOLE)
+            {
+                sink.WriteRef(args.values_[piece.hole]);
+            }
+        }
+        sink.WriteRef(detail::DOCUMENT_FOOTER);
+        sink.Flush();
+    }
+
+    void DocumentTemplate::CheckArguments(const Arguments &args) const
+    {
+        if (args.holes_ != holes_)
+        {
+            throw std::invalid_argument("Template arguments were made by another template"s);
+        }
+    }
+
+    void DocumentTemplate::AppendRendered(Holes &holes, std::string_view rendered)
+    {
+        std::size_t pos = 0;
+        while (true)
+        {
+            const std::size_t begin = rendered.find(HOLE_BEGIN, pos);
+            const std::size_t end = begin == std::string_view::npos
+                                        ? std::string_view::npos
+                                        : rendered.find(HOLE_END, begin + 1);
+            if (end == std::string_view::npos)
+            {
+                AppendStatic(rendered.substr(pos));
+                return;
+            }
+            AppendStatic(rendered.substr(pos, begin - pos));
+            const std::string_view marker = rendered.substr(begin + 1, end - begin - 1);
+            if (marker.empty() || (marker[0] != TEXT_HOLE && marker[0] != COLOR_HOLE))
+            {
+                throw std::invalid_argument("Bad template parameter marker: "s + std::string(marker));
+            }
+            const HoleKind kind = marker[0] == TEXT_HOLE ? HoleKind::TEXT : HoleKind::COLOR;
+            AppendHole(FindOrAddHole(holes, marker.substr(1), kind));
+            pos = end + 1;
+        }
+    }
+
+    void DocumentTemplate::AppendStatic(std::string_view bytes)
+    {
+        // Соседние неизменяемые фрагменты склеиваются в один
+        if (pieces_.empty() || pieces_.back().hole != NO_HOLE)
+        {
+            pieces_.push_back({bytes_.size(), bytes_.size(), NO_HOLE});
+        }
+        bytes_.append(bytes);
+        pieces_.back().end = bytes_.size();
+    }
+
+    void DocumentTemplate::AppendHole(std::size_t hole)
+    {
+        if (pieces_.empty() || pieces_.back().hole != NO_HOLE)
+        {
+            pieces_.push_back({bytes_.size(), bytes_.size(), NO_HOLE});
+        }
+        pieces_.back().hole = hole;
+    }
+
+    std::size_t DocumentTemplate::FindOrAddHole(Holes &holes, std::string_view name, HoleKind kind)
+    {
+        std::size_t hole = holes.Find(name);
+        if (hole == NO_HOLE)
+        {
+            hole = holes.names.size();
+            holes.names.emplace_back(name);
+            holes.kinds.push_back(kind);
+        }
+        else if (holes.kinds[hole] != kind)
+        {
+            throw std::invalid_argument("Template parameter used with different types: "s + std::string(name));
+        }
+        return hole;
+    }
+
+} // namespace svg
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "svg.h"
+
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace svg
+{
+
+    // Возвращает заглушку текстового параметра шаблона с именем name.
+    // Заглушку можно передать в Text::SetData
+    std::string TextHole(std::string_view name);
+
+    // Возвращает заглушку параметра-цвета шаблона с именем name.
+    // Заглушку можно передать в качестве строкового цвета
+    std::string ColorHole(std::string_view name);
+
+    /*
+     * Шаблон SVG-документа.
+     * Документ выводится один раз при построении шаблона и хранится как
+     * последовательность неизменяемых фрагментов и именованных параметров между ними.
+     * При выводе экземпляра документа форматируются только значения параметров
+     */
+    class DocumentTemplate
+    {
+        enum class HoleKind
+        {
+            TEXT,
+            COLOR,
+            CENTER,
+        };
+
+        // Имена и типы параметров. Общие для шаблона и его наборов аргументов
+        struct Holes
+        {
+            std::vector<std::string> names;
+            std::vector<HoleKind> kinds;
+
+            std::size_t Find(std::string_view name) const;
+        };
+
+    public:
+        /*
+         * Контейнер объектов, из которых строится шаблон.
+         * Заглушки Hole(name) в данных текста и цветах становятся параметрами
+         */
+        class Builder final : public ObjectContainer
+        {
+        public:
+            void AddPtr(std::unique_ptr<Object> &&obj) override;
+
+            // Добавляет круг, координаты центра которого задаются параметром name
+            Circle &AddCircle(std::string name, Circle circle = {});
+
+            // Выводит добавленные объекты и возвращает готовый шаблон
+            DocumentTemplate Build() const;
+
+        private:
+            struct Entry
+            {
+                std::unique_ptr<Object> object;
+                std::string center_hole;
+            };
+
+            std::vector<Entry> entries_;
+        };
+
+        /*
+         * Значения параметров для одного экземпляра документа.
+         * Значения форматируются в момент установки, поэтому один набор
+         * аргументов можно выводить многократно.
+         * Набор действителен и после перемещения или уничтожения шаблона,
+         * но выводить его можно только шаблоном, который его создал
+         */
+        class Arguments
+        {
+        public:
+            // Задаёт текст, который экранируется так же, как содержимое Text
+            Arguments &SetText(std::string_view name, std::string_view text);
+
+            // Задаёт цвет
+            Arguments &SetColor(std::string_view name, const Color &color);
+
+            // Задаёт центр круга, добавленного через Builder::AddCircle
+            Arguments &SetCenter(std::string_view name, Point center);
+
+        private:
+            friend class DocumentTemplate;
+
+            explicit Arguments(const DocumentTemplate &owner);
+
+            std::ostringstream &Reset();
+            void Store(std::string_view name, HoleKind kind);
+
+            std::shared_ptr<const Holes> holes_;
+            std::vector<std::string> values_;
+            std::ostringstream buf_;
+        };
+
+        // Создаёт набор аргументов со значениями по умолчанию:
+        // пустой текст, цвет none и центр в начале координат
+        Arguments MakeArguments() const;
+
+        // Выводит в ostream экземпляр документа с заданными значениями параметров
+        void Render(std::ostream &out, const Arguments &args) const;
+
+        // Выводит экземпляр документа в приёмник, передавая фрагменты без копирования
+        void Render(OutputSink &sink, const Arguments &args) const;
+
+    private:
+        // Неизменяемый фрагмент [begin, end) и следующий за ним параметр
+        struct Piece
+        {
+            std::size_t begin = 0;
+            std::size_t end = 0;
+            std::size_t hole = NO_HOLE;
+        };
+
+        static constexpr std::size_t NO_HOLE = static_cast<std::size_t>(-1);
+
+        DocumentTemplate() = default;
+
+        void CheckArguments(const Arguments &args) const;
+
+        void AppendRendered(Holes &holes, std::string_view rendered);
+        void AppendStatic(std::string_view bytes);
+        void AppendHole(std::size_t hole);
+        static std::size_t FindOrAddHole(Holes &holes, std::string_view name, HoleKind kind);
+
+        std::string bytes_;
+        std::vector<Piece> pieces_;
+        std::shared_ptr<const Holes> holes_;
+    };
+
+} // namespace svg